@@ -334,6 +334,12 @@ using boost::asio::ip::address;
 
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
 
 // 双方需要约定的特殊常量
 #define NOTAPPLICATED -3000
@@ -345,9 +351,29 @@ using boost::asio::ip::address;
 #define MULTI 3
 #define DIV 4
 
+// 优先级类别，数值越小越优先
+#define PRIORITY_DEFAULT 0     // 报文未指定优先级，使用函数的默认优先级
+#define PRIORITY_INTERACTIVE 1 // 交互类请求，对时延敏感
+#define PRIORITY_NORMAL 2
+#define PRIORITY_BATCH 3       // 批处理类请求
+#define PRIORITY_LEVELS 4      // 数组长度，0 号位置不使用
+
+// 函数映射字段的划分：高 8 位为优先级，低 24 位为函数映射
+#define PRIORITY_SHIFT 24
+#define FUNCTION_MASK 0xFFFFFF
+
+// 调度器每执行这么多请求输出一次各优先级的排队时间
+#define SCHEDULER_REPORT_INTERVAL 1000
+
 // 客户端发送给服务端的报文格式：4 字节的整数代表函数映射表，4 字节的整数表示 msgpack 的长度，后面不定长的部分为 msgpack 包。
+// 函数映射表的高 8 位可携带本次调用的优先级，为 0 时使用服务端为该函数配置的默认优先级，因此旧客户端无需修改。
 // 服务端发送给客户端的报文格式：1 个整数序列化之后的 msgpack 包
 
+// 将优先级写入函数映射字段的高 8 位
+inline int pack_opt(int opt, int priority) {
+    return (opt & FUNCTION_MASK) | ((priority & 0xFF) << PRIORITY_SHIFT);
+}
+
 // 客户端类
 class client : public boost::enable_shared_from_this<client> {
 public:
@@ -355,6 +381,14 @@ public:
         : io_service_(io_service), socket_(io_service), endpoint_(endpoint) {
         buffer = std::make_shared<std::array<char, MAXPACKSIZE>>(); // 初始化 buffer
         result = 0;
+        priority = PRIORITY_DEFAULT;
+    }
+    void set_priority(int p) // 设置之后调用的优先级，PRIORITY_DEFAULT 表示由服务端决定，超出范围的值被忽略
+    {
+        if (p < PRIORITY_DEFAULT || p > PRIORITY_BATCH) {
+            return;
+        }
+        priority = p;
     }
     int add(int a, int b) // 调用 add 和调用 start 的区别在于少传入一个代表函数映射的参数 opt
     {
@@ -376,7 +410,7 @@ public:
             static tcp::no_delay option(true);
             socket_.set_option(option); // 设置 socket 为无延时 socket
 
-            construct_rpc_data(opt, a, b); // 构造 RPC 包，并将包存入 buffer 成员变量中
+            construct_rpc_data(pack_opt(opt, priority), a, b); // 构造 RPC 包，并将包存入 buffer 成员变量中
             send_recive_rpc_data(ec);      // 发送需求包，并且接受客户端的结果
             std::cout << "send_recive_rpc_data return value: " << result << std::endl;
             return result; // 将结果返回
@@ -445,15 +479,180 @@ private:
     tcp::endpoint& endpoint_;
     std::shared_ptr<std::array<char, MAXPACKSIZE>> buffer;
     int result;
+    int priority;
 };
 
 // 服务端类
 
+// 请求调度器：按优先级分队列，以加权轮转的方式执行已解码的请求，并统计各优先级的排队时间
+// 内部状态由 mutex_ 保护，io_service 可由多个线程运行；同一时刻只有一个请求被调度执行
+class scheduler {
+public:
+    typedef std::function<void()> task;
+    typedef std::chrono::steady_clock clock;
+
+    scheduler(boost::asio::io_service& io_service)
+        : io_service_(io_service), draining_(false), executed_(0) {
+        weight_[PRIORITY_INTERACTIVE] = 8; // 默认权重，交互类请求获得大部分执行机会
+        weight_[PRIORITY_NORMAL] = 4;
+        weight_[PRIORITY_BATCH] = 1;
+        for (int p = 0; p < PRIORITY_LEVELS; ++p) {
+            current_[p] = 0;
+            wait_count_[p] = 0;
+            wait_total_[p] = 0;
+            wait_max_[p] = 0;
+        }
+    }
+
+    void set_method_priority(int func, int p) // 配置函数的默认优先级，PRIORITY_DEFAULT 表示取消配置
+    {
+        if (p == PRIORITY_DEFAULT) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            method_priority_.erase(func);
+            return;
+        }
+        if (!valid(p)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        method_priority_[func] = p;
+    }
+
+    void set_weight(int p, int weight) {
+        if (!valid(p) || weight < 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        weight_[p] = weight;
+    }
+
+    int classify(int opt) // 根据函数映射字段确定优先级：报文指定的优先级 -> 函数的默认优先级 -> PRIORITY_NORMAL
+    {
+        int p = (opt >> PRIORITY_SHIFT) & 0xFF;
+        if (valid(p)) {
+            return p;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = method_priority_.find(opt & FUNCTION_MASK);
+        if (it != method_priority_.end() && valid(it->second)) {
+            return it->second;
+        }
+        return PRIORITY_NORMAL;
+    }
+
+    void submit(int p, task t) // 将请求放入对应优先级的队列
+    {
+        if (!valid(p)) {
+            p = PRIORITY_NORMAL;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_[p].push_back(std::make_pair(clock::now(), std::move(t)));
+        if (!draining_) {
+            draining_ = true;
+            io_service_.post(boost::bind(&scheduler::run_one, this));
+        }
+    }
+
+    void report(std::ostream& os) const // 输出各优先级的排队时间
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_report(os);
+    }
+
+    static bool valid(int p) // 只有 PRIORITY_INTERACTIVE..PRIORITY_BATCH 对应实际的队列
+    {
+        return p >= PRIORITY_INTERACTIVE && p <= PRIORITY_BATCH;
+    }
+
+private:
+    // 每次只执行一个请求，然后重新投递到 io_service，使其间完成的读操作有机会把高优先级请求放入队列
+    // 请求本身在锁外执行，执行期间提交的请求可以正常入队
+    void run_one() {
+        std::pair<clock::time_point, task> item;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int p = pick();
+            item = std::move(queue_[p].front());
+            queue_[p].pop_front();
+
+            long long wait = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - item.first).count();
+            ++wait_count_[p];
+            wait_total_[p] += wait;
+            if (wait > wait_max_[p]) {
+                wait_max_[p] = wait;
+            }
+        }
+
+        item.second();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (++executed_ % SCHEDULER_REPORT_INTERVAL == 0) {
+            write_report(std::cout);
+        }
+
+        if (pending()) {
+            io_service_.post(boost::bind(&scheduler::run_one, this));
+        } else {
+            draining_ = false;
+        }
+    }
+
+    void write_report(std::ostream& os) const // 调用者需持有 mutex_
+    {
+        for (int p = PRIORITY_INTERACTIVE; p <= PRIORITY_BATCH; ++p) {
+            os << "priority " << p << " requests " << wait_count_[p]
+               << " avg wait " << (wait_count_[p] ? wait_total_[p] / wait_count_[p] : 0) << "us"
+               << " max wait " << wait_max_[p] << "us"
+               << " queued " << queue_[p].size() << std::endl;
+        }
+    }
+
+    int pick() // 平滑加权轮转，只在非空队列之间分配
+    {
+        int total = 0;
+        int best = 0;
+        for (int p = PRIORITY_INTERACTIVE; p <= PRIORITY_BATCH; ++p) {
+            if (queue_[p].empty()) {
+                continue;
+            }
+            current_[p] += weight_[p];
+            total += weight_[p];
+            if (best == 0 || current_[p] > current_[best]) {
+                best = p;
+            }
+        }
+        current_[best] -= total;
+        return best;
+    }
+
+    bool pending() const {
+        for (int p = PRIORITY_INTERACTIVE; p <= PRIORITY_BATCH; ++p) {
+            if (!queue_[p].empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    boost::asio::io_service& io_service_;
+    std::deque<std::pair<clock::time_point, task>> queue_[PRIORITY_LEVELS];
+    std::map<int, int> method_priority_;
+    int weight_[PRIORITY_LEVELS];
+    int current_[PRIORITY_LEVELS];
+    long long wait_count_[PRIORITY_LEVELS];
+    long long wait_total_[PRIORITY_LEVELS];
+    long long wait_max_[PRIORITY_LEVELS];
+    mutable std::mutex mutex_;
+    bool draining_;
+    long long executed_;
+};
+
 class session
     : public boost::enable_shared_from_this<session> {
 public:
-    session(boost::asio::io_service& io_service)
-        : io_service_(io_service), socket_(io_service) {
+    session(boost::asio::io_service& io_service, scheduler& scheduler)
+        : io_service_(io_service), socket_(io_service), scheduler_(scheduler) {
         buffer = std::make_shared<std::array<char, MAXPACKSIZE>>(); // 初始化 buffer
         *len_ = '\0';
         *opt_ = '\0';
@@ -525,7 +724,9 @@ private:
 
                                     msg = msgpack::unpack(async_buffer->data(), len);
 
-                                    rpc_caculate_return();
+                                    scheduler_.submit(scheduler_.classify(opt), [this, self]() { // 交给调度器按优先级执行
+                                        rpc_caculate_return();
+                                    });
                                 });
 
         // io_service_.run();
@@ -538,7 +739,7 @@ private:
         std::cout << socket_.remote_endpoint().address() << ":" << socket_.remote_endpoint().port() << " magpack " << std::get<0>(tp) << " " << std::get<1>(tp) << std::endl;
 
         int result = 0;
-        switch (opt) {
+        switch (opt & FUNCTION_MASK) {
         case ADD:
             result = std::get<0>(tp) + std::get<1>(tp);
             break;
@@ -584,6 +785,7 @@ private:
 private:
     boost::asio::io_service& io_service_;
     tcp::socket socket_;
+    scheduler& scheduler_;
     boost::asio::streambuf sbuf_;
     std::shared_ptr<std::array<char, MAXPACKSIZE>> buffer;
     char len_[4];
@@ -598,8 +800,8 @@ typedef boost::shared_ptr<session> session_ptr;
 class server {
 public:
     server(boost::asio::io_service& io_service, tcp::endpoint& endpoint)
-        : io_service_(io_service), acceptor_(io_service, endpoint) {
-        session_ptr new_session(new session(io_service_));
+        : io_service_(io_service), acceptor_(io_service, endpoint), scheduler_(io_service) {
+        session_ptr new_session(new session(io_service_, scheduler_));
         acceptor_.async_accept(new_session->socket(),              // 异步接受连接
                                boost::bind(&server::handle_accept, // 若有连接进入就调用成员函数 handle_accept()
                                            this,
@@ -614,7 +816,7 @@ public:
 
         new_session->start(); // 处理本次连接
 
-        new_session.reset(new session(io_service_)); // 重置 io_service
+        new_session.reset(new session(io_service_, scheduler_)); // 重置 io_service
         acceptor_.async_accept(new_session->socket(), boost::bind(&server::handle_accept, this, new_session,
                                                                   boost::asio::placeholders::error)); // 异步接受连接
 
@@ -625,8 +827,24 @@ public:
         io_service_.run();
     }
 
+    void set_method_priority(int func, int p) // 配置函数的默认优先级
+    {
+        scheduler_.set_method_priority(func, p);
+    }
+
+    void set_weight(int p, int weight) // 配置优先级的调度权重
+    {
+        scheduler_.set_weight(p, weight);
+    }
+
+    void report(std::ostream& os) const // 输出各优先级的排队时间
+    {
+        scheduler_.report(os);
+    }
+
 private:
     boost::asio::io_service& io_service_;
     tcp::acceptor acceptor_;
+    scheduler scheduler_;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+// 检查优先级报文格式与请求调度器的行为
+#include "../include/interface.hpp"
+#include <boost/asio/io_service.hpp>
+
+static int failed = 0;
+
+static void check(bool ok, const char* what) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << what << std::endl;
+    if (!ok) {
+        ++failed;
+    }
+}
+
+auto main() -> int {
+    // 报文格式：优先级写入高 8 位，PRIORITY_DEFAULT 时与旧客户端发送的报文完全相同
+    check(pack_opt(ADD, PRIORITY_DEFAULT) == ADD, "default priority keeps the old wire format");
+    check(pack_opt(DIV, PRIORITY_BATCH) == ((PRIORITY_BATCH << PRIORITY_SHIFT) | DIV), "priority is packed into the high 8 bits");
+    check((pack_opt(MULTI, PRIORITY_INTERACTIVE) & FUNCTION_MASK) == MULTI, "function id survives packing");
+
+    boost::asio::io_service io_service;
+    scheduler s(io_service);
+
+    // 优先级判定顺序：报文指定 -> 函数默认 -> PRIORITY_NORMAL
+    s.set_method_priority(DIV, PRIORITY_BATCH);
+    check(s.classify(ADD) == PRIORITY_NORMAL, "unconfigured method from an old client is normal");
+    check(s.classify(DIV) == PRIORITY_BATCH, "method default applies when the header has no class");
+    check(s.classify(pack_opt(DIV, PRIORITY_INTERACTIVE)) == PRIORITY_INTERACTIVE, "header class overrides the method default");
+    check(s.classify((9 << PRIORITY_SHIFT) | DIV) == PRIORITY_BATCH, "unknown header class falls back to the method default");
+
+    s.set_method_priority(ADD, 7);
+    check(s.classify(ADD) == PRIORITY_NORMAL, "out-of-range method class is rejected");
+    s.set_method_priority(DIV, PRIORITY_DEFAULT);
+    check(s.classify(DIV) == PRIORITY_NORMAL, "PRIORITY_DEFAULT resets a method");
+    s.set_method_priority(DIV, PRIORITY_BATCH);
+
+    // 加权轮转：默认权重 8/4/1，队列同时非空时的执行顺序
+    std::string order;
+    for (int i = 0; i < 6; ++i) {
+        s.submit(s.classify(DIV), [&order]() { order += 'b'; });
+    }
+    for (int i = 0; i < 3; ++i) {
+        s.submit(s.classify(pack_opt(ADD, PRIORITY_INTERACTIVE)), [&order]() { order += 'i'; });
+    }
+    s.submit(s.classify(ADD), [&order]() { order += 'n'; });
+    io_service.run();
+    std::cout << "order " << order << std::endl;
+    check(order == "iniibbbbbb", "weighted round-robin order");
+
+    // 批处理请求排队时到达的交互请求插队执行
+    order.clear();
+    for (int i = 0; i < 5; ++i) {
+        s.submit(PRIORITY_BATCH, [&order, &s, i]() {
+            order += 'b';
+            if (i == 0) {
+                s.submit(PRIORITY_INTERACTIVE, [&order]() { order += 'i'; });
+            }
+        });
+    }
+    io_service.restart();
+    io_service.run();
+    std::cout << "order " << order << std::endl;
+    check(order == "bibbbb", "interactive call overtakes queued batch calls");
+
+    s.report(std::cout);
+
+    return failed == 0 ? 0 : 1;
+}